@@ -10,6 +10,7 @@ namespace fs = std::filesystem;
 // GRRM file name-related constants
 inline const char* GRRM_INPUT_SUFFIX = "_INP4GEN.rrm";
 inline const char* GRRM_OUTPUT_SUFFIX = "_OUT4GEN.rrm";
+inline const char* GRRM_MI_REPORT_SUFFIX = "_XTBMI.log";
 
 // XTB file name-related constants
 inline const char* XTB_COMMAND = "xtb";
@@ -21,6 +22,13 @@ inline const char* XTB_HESSIAN_FILE = "hessian";
 inline const char* XTB_OPT_XYZ_FILE = "xtbopt.xyz";
 inline const char* XTB_LOG_FILE = "xtblog.log";
 
+// XTB file name-related constants for multi-level microiteration
+inline const char* XTB_PREOPT_XYZ_FILE = "xtbpreopt.xyz";
+inline const char* XTB_LAST_XYZ_FILE = "xtblast.xyz";
+inline const char* XTB_FF_LOG_FILE = "xtblog_ff.log";
+inline const char* XTB_SP_LOG_FILE = "xtblog_sp.log";
+inline const char* XTB_REFERENCE_DIR = "reference";
+
 // Name for environmental variables for XTB Settings
 inline const char* XTB_CHARGE_ENV = "XTB_CHARGE";
 inline const char* XTB_MULTI_ENV = "XTB_MULTI";
@@ -29,6 +37,12 @@ inline const char* XTB_SOLVENT_ENV = "XTB_SOLVENT";
 inline const char* XTB_PARAM_ENV = "XTB_PARAM";
 inline const char* XTB_SCRATCH_DIR_ENV = "XTB_SCRATCH_DIR";
 inline const char* XTB_KEEP_LOG_ENV = "XTB_KEEP_LOG";
+inline const char* XTB_MI_FF_PREOPT_ENV = "XTB_MI_FF_PREOPT";
+inline const char* XTB_MI_POLISH_CYCLES_ENV = "XTB_MI_POLISH_CYCLES";
+inline const char* XTB_MI_COMPARE_ENV = "XTB_MI_COMPARE";
+
+// Default max. optimization cycles at target level in multi-level microiteration
+inline const int XTB_MI_POLISH_CYCLES_DEFAULT = 5;
 
 struct GRRMInputData {
     std::string task;
@@ -48,6 +62,23 @@ struct GRRMInputData {
           {}  
 };
 
+// Results of Multi-Level MicroIteration (-1: cycles not found in log)
+struct MicroIterationInfo {
+    int ff_cycles;
+    int target_cycles;
+    bool reference_flag;
+    int reference_cycles;
+    std::string reference_energy;
+    // Constructor
+    MicroIterationInfo()
+        : ff_cycles(-1),
+          target_cycles(-1),
+          reference_flag(false),
+          reference_cycles(-1),
+          reference_energy("")
+          {}
+};
+
 /////////////////////////
 // Defined in grrm.cpp //
 /////////////////////////
@@ -100,3 +131,9 @@ bool prepare_constrain_file(const GRRMInputData&, const fs::path&);
 
 // Run XTB (in current directory)
 void run_xtb(const GRRMInputData&);
+
+// Run Multi-Level MicroIteration: GFN-FF pre-relaxation + target level polish (in current directory)
+MicroIterationInfo run_xtb_multilevel_microiteration(const GRRMInputData&);
+
+// Append Multi-Level MicroIteration results to report file
+void write_microiteration_report(const fs::path&, const MicroIterationInfo&, const std::string&);
@@ -29,6 +29,7 @@ int main(int argc, char* argv[]) {
     fs::path work_dir = scratch_dir / fs::path((job_name + "_" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + "_" + std::to_string(getpid())));
     fs::path input_file = fs::absolute(fs::path(job_name + GRRM_INPUT_SUFFIX));
     fs::path output_file = fs::absolute(fs::path(job_name + GRRM_OUTPUT_SUFFIX));
+    fs::path mi_report_file = fs::absolute(fs::path(job_name + GRRM_MI_REPORT_SUFFIX));
 
     // prepare working directory
     try {
@@ -44,9 +45,20 @@ int main(int argc, char* argv[]) {
         throw_error("TASK GUESS is unavailable with XTB.");
     }
 
+    // check flag for multi-level microiteration (GFN-FF pre-relaxation)
+    bool multilevel_flag = false;
+    if (const char* xtb_mi_ff_preopt = std::getenv(XTB_MI_FF_PREOPT_ENV)) {
+        multilevel_flag = (grrm_input_data.task == "mi") && is_true_string(std::string(xtb_mi_ff_preopt));
+    }
+
     // Run XTB in working directory
     fs::current_path(work_dir);
-    run_xtb(grrm_input_data);
+    MicroIterationInfo mi_info;
+    if (multilevel_flag) {
+        mi_info = run_xtb_multilevel_microiteration(grrm_input_data);
+    } else {
+        run_xtb(grrm_input_data);
+    }
 
     // Read data
     int full_num_atom = grrm_input_data.num_atom + grrm_input_data.num_frozen_atom;
@@ -126,13 +138,15 @@ int main(int argc, char* argv[]) {
 
     output.close();
 
+    // Report cycles of each level (and difference against single-level)
+    if (multilevel_flag) {
+        write_microiteration_report(mi_report_file, mi_info, energy);
+    }
+
     // check flag to keep log files
     bool keep_log_flag = false;
     if (const char* xtb_keep_log = std::getenv(XTB_KEEP_LOG_ENV)) {
-        std::string keep_log_value = to_lowercase(std::string(xtb_keep_log));
-        if (keep_log_value == "true" || keep_log_value == "1" || keep_log_value == "on") {
-            keep_log_flag = true;
-        }
+        keep_log_flag = is_true_string(std::string(xtb_keep_log));
     }
 
     // remove logs and work dir
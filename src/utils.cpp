@@ -72,4 +72,10 @@ std::string to_lowercase(const std::string& input) {
     std::transform(output.begin(), output.end(), output.begin(),
                    [](unsigned char c) { return std::tolower(c); });
     return output;
+}
+
+// check if string is true-like value (true/1/on)
+bool is_true_string(const std::string& input) {
+    std::string value = to_lowercase(trim(input));
+    return value == "true" || value == "1" || value == "on";
 }
\ No newline at end of file
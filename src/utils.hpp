@@ -19,4 +19,7 @@ std::string replace_tab(const std::string&);
 std::string trim(const std::string&);
 
 // convert string into lower case
-std::string to_lowercase(const std::string&);
\ No newline at end of file
+std::string to_lowercase(const std::string&);
+
+// check if string is true-like value (true/1/on)
+bool is_true_string(const std::string&);
\ No newline at end of file
@@ -1,4 +1,6 @@
+#include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <cstring>
 
 #include "grrm2xtb.hpp"
@@ -226,31 +228,16 @@ bool prepare_constrain_file(const GRRMInputData& input_data, const fs::path& con
     }
 }
 
-// Run XTB (in current directory)
-void run_xtb(const GRRMInputData& input_data) {
-
-    // Prepare xyz file and constrain file when required.
-    prepare_xyz_file(input_data, XTB_INPUT_XYZ_FILE);
-    bool constrain_flag = prepare_constrain_file(input_data, XTB_CONSTRAIN_FILE);
+// Get XTB options for charge, spin, and solvation
+static std::vector<std::string> get_common_options() {
+    std::vector<std::string> options;
 
-    // prep xtb command from here.
-    std::vector<std::string> xtb_commands = {"xtb"};
-    
-    // opt job if micro iteration is called
-    if (input_data.task == "mi") {
-        xtb_commands.push_back("--opt");
-    }
-    if (constrain_flag) {
-        xtb_commands.push_back("--input");
-        xtb_commands.push_back(XTB_CONSTRAIN_FILE);
-    }
-    
     // charge
     if (const char* xtb_charge = std::getenv(XTB_CHARGE_ENV)) {
         std::string charge_str(xtb_charge);
         if (!charge_str.empty() && to_lowercase(charge_str) != "none") {
-            xtb_commands.push_back("--chrg");
-            xtb_commands.push_back(charge_str);
+            options.push_back("--chrg");
+            options.push_back(charge_str);
         }
     }
     
@@ -259,8 +246,8 @@ void run_xtb(const GRRMInputData& input_data) {
         std::string multi_str(xtb_multi);
         if (!multi_str.empty() && to_lowercase(multi_str) != "none") {
             std::string spin = std::to_string(std::stoi(multi_str) - 1);
-            xtb_commands.push_back("--uhf");
-            xtb_commands.push_back(spin);
+            options.push_back("--uhf");
+            options.push_back(spin);
         }
     }
     
@@ -283,33 +270,54 @@ void run_xtb(const GRRMInputData& input_data) {
     
     // sanity check and set command
     if (solvation_flag && solvent_flag) {
-        xtb_commands.push_back("--" + solvation);
-        xtb_commands.push_back(solvent);
+        options.push_back("--" + solvation);
+        options.push_back(solvent);
     } else if (solvation_flag) {
         throw_error("Solvation is turned on but solvent is not specified.");
     } else if (solvent_flag) {
         throw_error("Solvation model is not selected but solvent is specified.");
     }
 
-    // param (gfn1/2/ff)
-    if (const char* xtb_param = std::getenv(XTB_PARAM_ENV)) {
-        if (strlen(xtb_param) > 0) {
-            xtb_commands.push_back("--gfn");
-            xtb_commands.push_back(xtb_param);
-        }
-    }
+    return options;
+}
 
+// Get XTB options for Hamiltonian (XTB_PARAM)
+static std::vector<std::string> get_param_options() {
+    std::vector<std::string> options;
+
+    // param (gfn1/2/ff/gxtb)
     if (const char* xtb_param = std::getenv(XTB_PARAM_ENV)) {
         if (strlen(xtb_param) > 0) {
             if (strcasecmp(xtb_param, "gxtb") == 0) {
-                xtb_commands.push_back("--gxtb");
+                options.push_back("--gxtb");
             } else {
-                xtb_commands.push_back("--gfn");
-                xtb_commands.push_back(xtb_param);
+                options.push_back("--gfn");
+                options.push_back(xtb_param);
             }
         }
     }
 
+    return options;
+}
+
+// Get XTB command for single-level calculation
+static std::vector<std::string> get_xtb_command(const GRRMInputData& input_data, bool constrain_flag) {
+    std::vector<std::string> xtb_commands = {XTB_COMMAND};
+    
+    // opt job if micro iteration is called
+    if (input_data.task == "mi") {
+        xtb_commands.push_back("--opt");
+    }
+    if (constrain_flag) {
+        xtb_commands.push_back("--input");
+        xtb_commands.push_back(XTB_CONSTRAIN_FILE);
+    }
+
+    std::vector<std::string> common_options = get_common_options();
+    xtb_commands.insert(xtb_commands.end(), common_options.begin(), common_options.end());
+    std::vector<std::string> param_options = get_param_options();
+    xtb_commands.insert(xtb_commands.end(), param_options.begin(), param_options.end());
+
     // task
     if (input_data.task == "egh") {
         xtb_commands.push_back("--acc");
@@ -321,16 +329,198 @@ void run_xtb(const GRRMInputData& input_data) {
     }
 
     xtb_commands.push_back(XTB_INPUT_XYZ_FILE);
+    return xtb_commands;
+}
 
-    // Create a command string from the vector
+// Create a command string from the vector
+static std::string join_command(const std::vector<std::string>& xtb_commands) {
     std::string command;
     for (const auto& cmd : xtb_commands) {
         command += cmd + " ";
     }
+    return command;
+}
+
+// Execute XTB command (in current directory) with output to log file. Return exit status.
+static int execute_xtb(const std::vector<std::string>& xtb_commands, const std::string& log_file) {
+    return std::system((join_command(xtb_commands) + " > " + log_file + " 2>&1").c_str());
+}
+
+// Read number of optimization cycles from XTB log file. Return -1 if not found.
+static int read_opt_cycles(const std::string& log_file) {
+    std::ifstream file(log_file);
+    if (!file.is_open()) {
+        return -1;
+    }
+
+    // "*** GEOMETRY OPTIMIZATION CONVERGED AFTER N ITERATIONS ***" or
+    // "*** FAILED TO CONVERGE GEOMETRY OPTIMIZATION IN N ITERATIONS ***"
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.find("GEOMETRY OPTIMIZATION") == std::string::npos || line.find("ITERATIONS") == std::string::npos) {
+            continue;
+        }
+        std::vector<std::string> split_line = split_by_blank(line);
+        for (size_t i = 1; i < split_line.size(); ++i) {
+            if (split_line[i] == "ITERATIONS") {
+                try {
+                    return std::stoi(split_line[i - 1]);
+                } catch (const std::exception& e) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+// Run XTB (in current directory)
+void run_xtb(const GRRMInputData& input_data) {
+
+    // Prepare xyz file and constrain file when required.
+    prepare_xyz_file(input_data, XTB_INPUT_XYZ_FILE);
+    bool constrain_flag = prepare_constrain_file(input_data, XTB_CONSTRAIN_FILE);
+
+    std::vector<std::string> xtb_commands = get_xtb_command(input_data, constrain_flag);
+    if (execute_xtb(xtb_commands, XTB_LOG_FILE) != 0) {
+        throw_error("XTB command failed: " + join_command(xtb_commands));
+    }
+}
+
+// Run Multi-Level MicroIteration: GFN-FF pre-relaxation + target level polish (in current directory)
+MicroIterationInfo run_xtb_multilevel_microiteration(const GRRMInputData& input_data) {
+    MicroIterationInfo info;
+
+    // Prepare xyz file and constrain file ($fix is always written for mi)
+    prepare_xyz_file(input_data, XTB_INPUT_XYZ_FILE);
+    prepare_constrain_file(input_data, XTB_CONSTRAIN_FILE);
+    std::vector<std::string> common_options = get_common_options();
+    std::vector<std::string> param_options = get_param_options();
+
+    // 1st level: relax environment with GFN-FF under the same constraints
+    std::vector<std::string> ff_commands = {XTB_COMMAND, "--opt", "--input", XTB_CONSTRAIN_FILE};
+    ff_commands.insert(ff_commands.end(), common_options.begin(), common_options.end());
+    ff_commands.push_back("--gfnff");
+    ff_commands.push_back(XTB_INPUT_XYZ_FILE);
+
+    int result = execute_xtb(ff_commands, XTB_FF_LOG_FILE);
+    info.ff_cycles = read_opt_cycles(XTB_FF_LOG_FILE);
+
+    // Unconverged GFN-FF structure is still a reasonable starting point for the target level
+    if (result == 0 && fs::exists(XTB_OPT_XYZ_FILE)) {
+        fs::rename(XTB_OPT_XYZ_FILE, XTB_PREOPT_XYZ_FILE);
+    } else if (fs::exists(XTB_LAST_XYZ_FILE)) {
+        fs::rename(XTB_LAST_XYZ_FILE, XTB_PREOPT_XYZ_FILE);
+    } else {
+        throw_error("XTB GFN-FF pre-relaxation failed. See " + std::string(XTB_FF_LOG_FILE));
+    }
+
+    // 2nd level: polish with target level (XTB_MI_POLISH_CYCLES overrides the cycle limit, none: no limit)
+    int polish_cycles = XTB_MI_POLISH_CYCLES_DEFAULT;
+    if (const char* xtb_polish_cycles = std::getenv(XTB_MI_POLISH_CYCLES_ENV)) {
+        std::string cycles_str = trim(std::string(xtb_polish_cycles));
+        if (to_lowercase(cycles_str) == "none") {
+            polish_cycles = 0;
+        } else if (!cycles_str.empty()) {
+            polish_cycles = std::stoi(cycles_str);
+            if (polish_cycles <= 0) {
+                throw_error("XTB_MI_POLISH_CYCLES should be a positive integer or none.");
+            }
+        }
+    }
+    std::vector<std::string> target_commands = {XTB_COMMAND, "--opt"};
+    if (polish_cycles > 0) {
+        target_commands.push_back("--cycles");
+        target_commands.push_back(std::to_string(polish_cycles));
+    }
+    target_commands.push_back("--input");
+    target_commands.push_back(XTB_CONSTRAIN_FILE);
+    target_commands.insert(target_commands.end(), common_options.begin(), common_options.end());
+    target_commands.insert(target_commands.end(), param_options.begin(), param_options.end());
+    target_commands.push_back("--grad");
+    target_commands.push_back(XTB_PREOPT_XYZ_FILE);
+
+    result = execute_xtb(target_commands, XTB_LOG_FILE);
+    info.target_cycles = read_opt_cycles(XTB_LOG_FILE);
+
+    if (result != 0 || !fs::exists(XTB_OPT_XYZ_FILE)) {
+        // Only running out of the cycle limit is acceptable, other failures stop as in run_xtb
+        bool cycle_limit_flag = (polish_cycles > 0) && (info.target_cycles == polish_cycles);
+        if (!cycle_limit_flag || !fs::exists(XTB_LAST_XYZ_FILE)) {
+            throw_error("XTB command failed: " + join_command(target_commands));
+        }
 
-    // Run the command and redirect output
-    int result = std::system((command + " > " + XTB_LOG_FILE + " 2>&1").c_str());
-    if (result != 0) {
-        throw_error("XTB command failed: " + command);
+        // Polish stopped at the cycle limit: energy and gradient at the last structure with target level
+        fs::rename(XTB_LAST_XYZ_FILE, XTB_OPT_XYZ_FILE);
+
+        std::vector<std::string> sp_commands = {XTB_COMMAND, "--input", XTB_CONSTRAIN_FILE};
+        sp_commands.insert(sp_commands.end(), common_options.begin(), common_options.end());
+        sp_commands.insert(sp_commands.end(), param_options.begin(), param_options.end());
+        sp_commands.push_back("--grad");
+        sp_commands.push_back(XTB_OPT_XYZ_FILE);
+        if (execute_xtb(sp_commands, XTB_SP_LOG_FILE) != 0) {
+            throw_error("XTB command failed in target level single point. See " + std::string(XTB_SP_LOG_FILE));
+        }
     }
+
+    // Optional: single-level microiteration in sub directory for comparison
+    if (const char* xtb_mi_compare = std::getenv(XTB_MI_COMPARE_ENV)) {
+        if (is_true_string(std::string(xtb_mi_compare))) {
+            info.reference_flag = true;
+
+            // Failure here should not affect the result: leave REF fields empty with warning
+            std::error_code ec;
+            fs::path reference_dir = fs::absolute(XTB_REFERENCE_DIR);
+            fs::create_directories(reference_dir, ec);
+            if (!ec) {
+                fs::copy_file(XTB_INPUT_XYZ_FILE, reference_dir / XTB_INPUT_XYZ_FILE, ec);
+            }
+            if (!ec) {
+                fs::copy_file(XTB_CONSTRAIN_FILE, reference_dir / XTB_CONSTRAIN_FILE, ec);
+            }
+            if (ec) {
+                std::cerr << "Warning: failed to prepare reference microiteration: " << ec.message() << std::endl;
+                return info;
+            }
+
+            fs::path current_dir = fs::current_path();
+            fs::current_path(reference_dir);
+            std::vector<std::string> reference_commands = get_xtb_command(input_data, true);
+            if (execute_xtb(reference_commands, XTB_LOG_FILE) == 0 && fs::exists(XTB_ENERGY_FILE)) {
+                info.reference_energy = read_energy(XTB_ENERGY_FILE);
+                info.reference_cycles = read_opt_cycles(XTB_LOG_FILE);
+            } else {
+                std::cerr << "Warning: reference microiteration failed: " << join_command(reference_commands) << std::endl;
+            }
+            fs::current_path(current_dir);
+        }
+    }
+
+    return info;
+}
+
+// Append Multi-Level MicroIteration results to report file
+void write_microiteration_report(const fs::path& report_file, const MicroIterationInfo& info, const std::string& energy) {
+    std::ofstream ofs(report_file, std::ios::app);
+    if (!ofs) {
+        std::cerr << "Warning: failed to open file: " << report_file.string() << std::endl;
+        return;
+    }
+
+    ofs << "GFNFF_CYCLES= " << std::setw(5) << info.ff_cycles
+        << "  TARGET_CYCLES= " << std::setw(5) << info.target_cycles
+        << "  ENERGY= " << energy;
+
+    // Energy difference against single-level microiteration (Hartree)
+    if (info.reference_flag && !info.reference_energy.empty()) {
+        double delta_energy = std::stod(energy) - std::stod(info.reference_energy);
+        ofs << "  REF_CYCLES= " << std::setw(5) << info.reference_cycles
+            << "  REF_ENERGY= " << info.reference_energy
+            << "  DELTA_E= " << std::fixed << std::setprecision(12) << delta_energy;
+    } else if (info.reference_flag) {
+        ofs << "  REF_CYCLES=  REF_ENERGY=  DELTA_E=";
+    }
+    ofs << "\n";
+
+    ofs.close();
 }
@@ -22,6 +22,8 @@ export OMP_STACKSIZE=1G
 export XTB_PARAM=2
 export XTB_CHARGE=0
 export XTB_MULTI=1
+# export XTB_MI_FF_PREOPT=true
+# export XTB_MI_POLISH_CYCLES=5
 # export XTB_SCRATCH_DIR=/scr/${USER}/${LSB_JOBID}
 
 # Add current dir to Path (for GRRM2XTB)